@@ -0,0 +1,75 @@
+#include "alloc_counter.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#if defined(V60_TRACK_ALLOCS)
+#include <v60/alloc.hpp>
+
+// v60 already counts allocations, and owns operator new.
+namespace v60::bench {
+alloc_snapshot allocations() {
+    auto total = total_allocations();
+    return {total.count, total.bytes};
+}
+
+void ignore_allocations_on_this_thread() {
+    untrack_allocations_on_this_thread();
+}
+} // namespace v60::bench
+#else
+namespace v60::bench {
+namespace {
+std::atomic<uint64_t> g_allocs{0};
+std::atomic<uint64_t> g_alloc_bytes{0};
+thread_local bool t_uncounted = false;
+} // namespace
+
+alloc_snapshot allocations() {
+    return {g_allocs.load(std::memory_order_relaxed),
+            g_alloc_bytes.load(std::memory_order_relaxed)};
+}
+
+void ignore_allocations_on_this_thread() {
+    t_uncounted = true;
+}
+
+namespace {
+void* counted_alloc(std::size_t size) {
+    if (!t_uncounted) {
+        g_allocs.fetch_add(1, std::memory_order_relaxed);
+        g_alloc_bytes.fetch_add(size, std::memory_order_relaxed);
+    }
+    if (auto ptr = std::malloc(size ? size : 1)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+} // namespace
+} // namespace v60::bench
+
+void* operator new(std::size_t size) {
+    return v60::bench::counted_alloc(size);
+}
+
+void* operator new[](std::size_t size) {
+    return v60::bench::counted_alloc(size);
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+#endif
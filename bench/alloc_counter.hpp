@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+
+namespace v60::bench {
+struct alloc_snapshot {
+    uint64_t count = 0;
+    uint64_t bytes = 0;
+
+    alloc_snapshot operator-(const alloc_snapshot& rhs) const {
+        return {count - rhs.count, bytes - rhs.bytes};
+    }
+};
+
+/**
+ * Number of heap allocations made so far by the threads that are counted.
+ */
+alloc_snapshot allocations();
+
+/**
+ * Stops counting the allocations of the calling thread, i.e. the load
+ * generator's.
+ */
+void ignore_allocations_on_this_thread();
+} // namespace v60::bench
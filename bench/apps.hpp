@@ -0,0 +1,49 @@
+#pragma once
+
+#include <v60/v60.hpp>
+
+/**
+ * The route trees of the examples, so that they can be started in process.
+ * Keep these in sync with examples/. Middleware that only logs to stderr is
+ * left out, since it would end up dominating the measurements.
+ */
+namespace v60::bench {
+// examples/barebones.cpp
+inline auto barebones_app() {
+    return get<"/hello">([](Request auto req, Response auto resp) -> task<void> {
+        co_await resp.send("Hello from v60!");
+    });
+}
+
+// examples/parameter.cpp
+inline auto parameter_app() {
+    return get<"/hello/:name">([](Request auto req, Response auto resp) -> task<void> {
+        co_await resp.send("Hello from v60, " + std::string(get<"name">(req.params)));
+    });
+}
+
+// examples/backend.cpp
+inline auto backend_app() {
+    auto name_handler = [](Request auto req, Response auto resp) -> task<void> {
+        return resp.send("hello " + std::string(get<"userId">(req.params)));
+    };
+
+    auto age_handler = [](Request auto req, Response auto resp) -> task<void> {
+        return resp.json(42);
+    };
+
+    auto user_router =
+        group(get<"/name">(name_handler),
+              use(object_body<object<member<"age", int64_t>>>, post<"/age">(age_handler)));
+
+    return use(server_fault_mw, use(not_found_mw, bind<"/user/:userId">(std::move(user_router))));
+}
+
+// examples/cookies.cpp
+inline auto cookies_app() {
+    return use(cookie_parser<object<member<"name", std::string>>>,
+               get<"/hello">([](Request auto req, Response auto resp) -> task<void> {
+                   co_await resp.send("Hello from v60, " + get<"name">(req.cookies));
+               }));
+}
+} // namespace v60::bench
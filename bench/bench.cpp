@@ -0,0 +1,194 @@
+#include "alloc_counter.hpp"
+#include "apps.hpp"
+#include "load_generator.hpp"
+
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string_view>
+#include <thread>
+
+namespace v60::bench {
+namespace {
+struct scenario {
+    std::string_view name;
+    std::function<any_routable<request<object<>, std::string_view>, any_response>()> app;
+    load_options load;
+};
+
+struct settings {
+    int connections = 16;
+    double rate = 0;
+    std::chrono::milliseconds duration{5000};
+    std::chrono::milliseconds warmup{1000};
+    unsigned short port = 18080;
+    std::string_view only;
+};
+
+std::vector<scenario> scenarios() {
+    std::vector<scenario> res;
+
+    res.push_back({"barebones", [] { return barebones_app(); }, {.target = "/hello"}});
+    res.push_back({"parameter", [] { return parameter_app(); }, {.target = "/hello/bench"}});
+    res.push_back({"backend_get", [] { return backend_app(); }, {.target = "/user/42/name"}});
+    res.push_back({"backend_post",
+                   [] { return backend_app(); },
+                   {.method = http::verb::post,
+                    .target = "/user/42/age",
+                    .headers = {{"content-type", "application/json"}},
+                    .body = R"({"age": 42})"}});
+    res.push_back({"cookies",
+                   [] { return cookies_app(); },
+                   {.target = "/hello", .headers = {{"cookie", "name=bench; theme=dark"}}}});
+
+    return res;
+}
+
+/**
+ * Per stage allocations over the measured window, as recorded by v60 itself
+ * when built with V60_TRACK_ALLOCS.
+ */
+std::vector<alloc_stage_stats> stage_delta(const std::vector<alloc_stage_stats>& before,
+                                           const std::vector<alloc_stage_stats>& after) {
+    std::vector<alloc_stage_stats> res;
+    for (auto& stage : after) {
+        auto delta = stage;
+        for (auto& old : before) {
+            if (old.name == stage.name) {
+                delta.requests -= old.requests;
+                delta.allocs = delta.allocs - old.allocs;
+            }
+        }
+        res.push_back(std::move(delta));
+    }
+    return res;
+}
+
+void print_result(std::ostream& os,
+                  const scenario& sc,
+                  const load_result& res,
+                  alloc_snapshot allocs,
+                  const std::vector<alloc_stage_stats>& stages) {
+    auto per_req = [&](uint64_t val) {
+        return res.requests ? static_cast<double>(val) / res.requests : 0.0;
+    };
+    auto us = [&](double q) { return res.percentile(q) / 1000.0; };
+
+    os << "    {\"name\": \"" << sc.name << "\", "
+       << "\"mode\": \"" << (sc.load.rate > 0 ? "open" : "closed") << "\", "
+       << "\"connections\": " << sc.load.connections << ", "
+       << "\"target_rate\": " << sc.load.rate << ", "
+       << "\"requests\": " << res.requests << ", "
+       << "\"non_2xx\": " << res.non_2xx << ", "
+       << "\"errors\": " << res.errors << ", "
+       << "\"seconds\": " << res.seconds << ", "
+       << "\"rps\": " << res.rps() << ", "
+       << "\"latency_us\": {\"p50\": " << us(0.5) << ", \"p99\": " << us(0.99)
+       << ", \"p999\": " << us(0.999) << ", \"max\": " << us(1) << "}, "
+       << "\"allocs_per_req\": " << per_req(allocs.count) << ", "
+       << "\"alloc_bytes_per_req\": " << per_req(allocs.bytes);
+
+    if (tracking_allocations) {
+        os << ", \"alloc_stages\": {";
+        bool first = true;
+        for (auto& stage : stages) {
+            auto per_stage_req = [&](uint64_t val) {
+                return stage.requests ? static_cast<double>(val) / stage.requests : 0.0;
+            };
+            os << (first ? "" : ", ") << "\"" << stage.name << "\": {"
+               << "\"requests\": " << stage.requests << ", "
+               << "\"allocs_per_req\": " << per_stage_req(stage.allocs.count) << ", "
+               << "\"alloc_bytes_per_req\": " << per_stage_req(stage.allocs.bytes) << "}";
+            first = false;
+        }
+        os << "}";
+    }
+    os << "}";
+}
+
+int run(const settings& cfg) {
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "{\n  \"scenarios\": [\n";
+
+    bool first = true;
+    auto port = cfg.port;
+    for (auto& sc : scenarios()) {
+        if (!cfg.only.empty() && cfg.only != sc.name) {
+            continue;
+        }
+
+        sc.load.port = port++;
+        sc.load.connections = cfg.connections;
+        sc.load.rate = cfg.rate;
+        sc.load.duration = cfg.duration;
+        sc.load.warmup = cfg.warmup;
+
+        server serv(sc.app());
+        std::thread server_thread([&] { serv.listen(sc.load.port); });
+
+        alloc_snapshot allocs;
+        std::vector<alloc_stage_stats> stages;
+        auto res = run_load(
+            sc.load,
+            [&] {
+                allocs = allocations();
+                stages = allocation_stages();
+            },
+            [&] {
+                allocs = allocations() - allocs;
+                stages = stage_delta(stages, allocation_stages());
+            });
+
+        serv.stop(std::chrono::seconds(1));
+        server_thread.join();
+
+        if (!first) {
+            std::cout << ",\n";
+        }
+        first = false;
+        print_result(std::cout, sc, res, allocs, stages);
+    }
+
+    std::cout << "\n  ]\n}\n";
+    return 0;
+}
+
+int usage(const char* self) {
+    std::cerr << "Usage: " << self
+              << " [--connections N] [--rate REQ_PER_SEC] [--duration MS] [--warmup MS]"
+                 " [--port P] [--scenario NAME]\n";
+    return 1;
+}
+} // namespace
+} // namespace v60::bench
+
+int main(int argc, char** argv) {
+    using namespace v60::bench;
+    ignore_allocations_on_this_thread();
+
+    settings cfg;
+    for (int i = 1; i < argc; ++i) {
+        std::string_view arg = argv[i];
+        if (i + 1 == argc) {
+            return usage(argv[0]);
+        }
+        std::string_view val = argv[++i];
+        if (arg == "--connections") {
+            cfg.connections = std::atoi(val.data());
+        } else if (arg == "--rate") {
+            cfg.rate = std::atof(val.data());
+        } else if (arg == "--duration") {
+            cfg.duration = std::chrono::milliseconds(std::atoi(val.data()));
+        } else if (arg == "--warmup") {
+            cfg.warmup = std::chrono::milliseconds(std::atoi(val.data()));
+        } else if (arg == "--port") {
+            cfg.port = static_cast<unsigned short>(std::atoi(val.data()));
+        } else if (arg == "--scenario") {
+            cfg.only = val;
+        } else {
+            return usage(argv[0]);
+        }
+    }
+
+    return run(cfg);
+}
@@ -0,0 +1,187 @@
+#include "load_generator.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/detached.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/redirect_error.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/use_awaitable.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/beast/core/flat_buffer.hpp>
+#include <boost/beast/http.hpp>
+#include <sstream>
+
+namespace v60::bench {
+namespace {
+namespace net = boost::asio;
+namespace beast = boost::beast;
+using tcp = net::ip::tcp;
+using clock = std::chrono::steady_clock;
+
+enum class phase
+{
+    warmup,
+    measure,
+    done
+};
+
+struct shared_state {
+    const load_options& opts;
+    std::string request;
+    phase current = phase::warmup;
+    clock::time_point start;
+    load_result result;
+};
+
+std::string serialize_request(const load_options& opts) {
+    beast::http::request<beast::http::string_body> req{opts.method, opts.target, 11};
+    req.set(beast::http::field::host, opts.host);
+    for (auto& [key, val] : opts.headers) {
+        req.set(key, val);
+    }
+    req.body() = opts.body;
+    req.prepare_payload();
+
+    std::ostringstream os;
+    os << req;
+    return os.str();
+}
+
+net::awaitable<tcp::socket> connect(const load_options& opts) {
+    auto ex = co_await net::this_coro::executor;
+    tcp::endpoint endpoint{net::ip::make_address(opts.host), opts.port};
+
+    // The server might still be setting up its acceptor.
+    for (int attempt = 0;; ++attempt) {
+        tcp::socket socket(ex);
+        beast::error_code ec;
+        co_await socket.async_connect(endpoint, net::redirect_error(net::use_awaitable, ec));
+        if (!ec) {
+            socket.set_option(tcp::no_delay(true));
+            co_return socket;
+        }
+        if (attempt == 100) {
+            throw beast::system_error(ec);
+        }
+        net::steady_timer timer(ex, std::chrono::milliseconds(20));
+        co_await timer.async_wait(net::use_awaitable);
+    }
+}
+
+net::awaitable<void> run_connection(shared_state& state, int index) {
+    auto& opts = state.opts;
+    auto ex = co_await net::this_coro::executor;
+    auto socket = co_await connect(opts);
+    beast::flat_buffer buffer;
+    net::steady_timer timer(ex);
+
+    auto interval = opts.rate > 0 ? std::chrono::duration<double>(opts.connections / opts.rate)
+                                  : std::chrono::duration<double>(0);
+    auto next_due = clock::now() + std::chrono::duration_cast<clock::duration>(
+                                       interval * index / opts.connections);
+
+    while (state.current != phase::done) {
+        auto begin = clock::now();
+        if (opts.rate > 0) {
+            if (next_due > begin) {
+                timer.expires_at(next_due);
+                co_await timer.async_wait(net::use_awaitable);
+            }
+            begin = next_due;
+            next_due += std::chrono::duration_cast<clock::duration>(interval);
+        }
+
+        beast::error_code ec;
+        co_await net::async_write(socket,
+                                  net::buffer(state.request),
+                                  net::redirect_error(net::use_awaitable, ec));
+
+        beast::http::response<beast::http::string_body> res;
+        if (!ec) {
+            co_await beast::http::async_read(
+                socket, buffer, res, net::redirect_error(net::use_awaitable, ec));
+        }
+
+        auto end = clock::now();
+        if (state.current != phase::measure) {
+            if (ec) {
+                co_return;
+            }
+            continue;
+        }
+
+        if (ec) {
+            ++state.result.errors;
+            co_return;
+        }
+
+        ++state.result.requests;
+        if (res.result_int() < 200 || res.result_int() >= 300) {
+            ++state.result.non_2xx;
+        }
+        state.result.latencies_ns.push_back(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count());
+
+        if (!res.keep_alive()) {
+            socket = co_await connect(opts);
+        }
+    }
+}
+
+net::awaitable<void> run_phases(net::io_context& ioc,
+                                shared_state& state,
+                                const std::function<void()>& measure_begin,
+                                const std::function<void()>& measure_end) {
+    net::steady_timer timer(co_await net::this_coro::executor);
+
+    timer.expires_after(state.opts.warmup);
+    co_await timer.async_wait(net::use_awaitable);
+
+    if (measure_begin) {
+        measure_begin();
+    }
+    state.current = phase::measure;
+    state.start = clock::now();
+
+    timer.expires_after(state.opts.duration);
+    co_await timer.async_wait(net::use_awaitable);
+
+    state.current = phase::done;
+    state.result.seconds = std::chrono::duration<double>(clock::now() - state.start).count();
+    if (measure_end) {
+        measure_end();
+    }
+
+    // Don't wait on the requests still in flight.
+    ioc.stop();
+}
+} // namespace
+
+int64_t load_result::percentile(double q) const {
+    if (latencies_ns.empty()) {
+        return 0;
+    }
+    auto index = static_cast<size_t>(std::ceil(q * latencies_ns.size())) - 1;
+    return latencies_ns[std::min(index, latencies_ns.size() - 1)];
+}
+
+load_result run_load(const load_options& opts,
+                     const std::function<void()>& measure_begin,
+                     const std::function<void()>& measure_end) {
+    net::io_context ioc{1};
+    shared_state state{opts, serialize_request(opts)};
+
+    for (int i = 0; i < opts.connections; ++i) {
+        net::co_spawn(ioc, run_connection(state, i), net::detached);
+    }
+    net::co_spawn(ioc, run_phases(ioc, state, measure_begin, measure_end), net::detached);
+
+    ioc.run();
+
+    std::sort(state.result.latencies_ns.begin(), state.result.latencies_ns.end());
+    return std::move(state.result);
+}
+} // namespace v60::bench
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <boost/beast/http/verb.hpp>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace v60::bench {
+struct load_options {
+    std::string host = "127.0.0.1";
+    unsigned short port = 8080;
+
+    boost::beast::http::verb method = boost::beast::http::verb::get;
+    std::string target = "/";
+    std::vector<std::pair<std::string, std::string>> headers;
+    std::string body;
+
+    int connections = 16;
+
+    // Requests per second across all connections. With 0, every connection
+    // sends its next request as soon as it gets a response (closed loop).
+    // Otherwise, requests are sent on a fixed schedule, and latency is
+    // measured from the time the request was due, not when it was actually
+    // sent, so that a stalled server can't hide its queueing delay (open
+    // loop).
+    double rate = 0;
+
+    std::chrono::milliseconds warmup{1000};
+    std::chrono::milliseconds duration{5000};
+};
+
+struct load_result {
+    uint64_t requests = 0;
+    uint64_t non_2xx = 0;
+    uint64_t errors = 0;
+    double seconds = 0;
+
+    // Latency of every request completed in the measured window, sorted.
+    std::vector<int64_t> latencies_ns;
+
+    double rps() const {
+        return seconds > 0 ? requests / seconds : 0;
+    }
+
+    // Latency at the given quantile in (0, 1], in nanoseconds.
+    int64_t percentile(double q) const;
+};
+
+/**
+ * Runs a load test against an HTTP/1.1 server, on the calling thread.
+ *
+ * measure_begin and measure_end are called on the same thread when the
+ * measured window starts and ends, after the warmup.
+ */
+load_result run_load(const load_options& opts,
+                     const std::function<void()>& measure_begin = {},
+                     const std::function<void()>& measure_end = {});
+} // namespace v60::bench
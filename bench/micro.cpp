@@ -0,0 +1,287 @@
+#include "alloc_counter.hpp"
+
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/detached.hpp>
+#include <boost/asio/io_context.hpp>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <linux/perf_event.h>
+#include <optional>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <v60/v60.hpp>
+
+/**
+ * Micro-benchmarks for the routing layer, without any socket I/O: requests are
+ * synthesized in memory and responses go to a sender that drops them.
+ */
+namespace v60::bench {
+namespace {
+template<class T>
+void do_not_optimize(T&& val) {
+    asm volatile("" : : "g"(&val) : "memory");
+}
+
+/**
+ * Counts retired instructions of the calling thread, if the kernel lets us.
+ */
+class instruction_counter {
+public:
+    instruction_counter() {
+        perf_event_attr attr{};
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        m_fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+
+    ~instruction_counter() {
+        if (m_fd >= 0) {
+            close(m_fd);
+        }
+    }
+
+    void start() {
+        if (m_fd >= 0) {
+            ioctl(m_fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(m_fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+
+    std::optional<uint64_t> stop() {
+        if (m_fd < 0) {
+            return {};
+        }
+        ioctl(m_fd, PERF_EVENT_IOC_DISABLE, 0);
+        uint64_t count = 0;
+        if (read(m_fd, &count, sizeof(count)) != sizeof(count)) {
+            return {};
+        }
+        return count;
+    }
+
+private:
+    int m_fd = -1;
+};
+
+struct result {
+    std::string name;
+    uint64_t iterations;
+    double ns_per_op;
+    std::optional<double> instructions_per_op;
+    double allocs_per_op;
+};
+
+std::vector<result> g_results;
+bool g_first_result = true;
+
+template<class FnT>
+void measure(std::string name, uint64_t iterations, FnT&& fn) {
+    // Warm up caches and any lazily initialized state.
+    fn(iterations / 10 + 1);
+
+    instruction_counter instructions;
+    auto allocs = allocations();
+    instructions.start();
+    auto begin = std::chrono::steady_clock::now();
+
+    fn(iterations);
+
+    auto end = std::chrono::steady_clock::now();
+    auto instr = instructions.stop();
+    allocs = allocations() - allocs;
+
+    double n = static_cast<double>(iterations);
+    result res{std::move(name),
+               iterations,
+               std::chrono::duration<double, std::nano>(end - begin).count() / n,
+               instr ? std::optional<double>(*instr / n) : std::nullopt,
+               allocs.count / n};
+
+    std::cout << (g_first_result ? "" : ",\n") << "    {\"name\": \"" << res.name
+              << "\", \"iterations\": " << res.iterations
+              << ", \"ns_per_op\": " << res.ns_per_op << ", \"instructions_per_op\": ";
+    if (res.instructions_per_op) {
+        std::cout << *res.instructions_per_op;
+    } else {
+        std::cout << "null";
+    }
+    std::cout << ", \"allocs_per_op\": " << res.allocs_per_op << "}" << std::flush;
+    g_first_result = false;
+}
+
+/**
+ * Runs the given coroutine to completion on the calling thread.
+ */
+void run_task(task<void> t) {
+    boost::asio::io_context ioc{1};
+    boost::asio::co_spawn(ioc, std::move(t), [](std::exception_ptr err) {
+        if (err) {
+            std::rethrow_exception(err);
+        }
+    });
+    ioc.run();
+}
+
+using base_req = request<object<>, std::string_view>;
+
+base_req make_request(http::verb verb, std::string_view target) {
+    http::str_request raw{verb, boost::string_view(target.data(), target.size()), 11};
+    raw.set(http::field::host, "localhost");
+    return base_req{base_request{std::move(raw)}, {}, {}};
+}
+
+inline auto null_send = [](http::str_response) -> task<void> { co_return; };
+using null_response = response<decltype(null_send)>;
+
+inline auto noop_handler = [](Request auto, Response auto) -> task<void> { co_return; };
+
+/**
+ * "/route/<I>" as a fixed_string.
+ */
+template<size_t I>
+constexpr auto route_path() {
+    constexpr auto digits = [] {
+        size_t n = 1;
+        for (auto i = I; i >= 10; i /= 10) ++n;
+        return n;
+    }();
+
+    fixed_string<sizeof("/route/") + digits> res{};
+    std::copy_n("/route/", 7, res.begin());
+    auto val = I;
+    for (size_t i = 0; i < digits; ++i) {
+        res.val[7 + digits - 1 - i] = static_cast<char>('0' + val % 10);
+        val /= 10;
+    }
+    return res;
+}
+
+static_assert(std::string_view(route_path<42>()) == "/route/42");
+
+template<size_t Offset, size_t... Is>
+auto make_flat_table(std::index_sequence<Is...>) {
+    return group(get<route_path<Offset + Is>()>(noop_handler)...);
+}
+
+/**
+ * A group of N routes. Groups hold their routes in a tuple, which doesn't
+ * scale to a thousand elements, so large tables are groups of groups of 100.
+ */
+template<size_t N>
+auto make_table() {
+    if constexpr (N <= 100) {
+        return make_flat_table<0>(std::make_index_sequence<N>{});
+    } else {
+        return [&]<size_t... Chunks>(std::index_sequence<Chunks...>) {
+            return group(make_flat_table<Chunks * 100>(std::make_index_sequence<100>{})...);
+        }(std::make_index_sequence<N / 100>{});
+    }
+}
+
+template<class RouteT, class Resp = null_response>
+void bench_dispatch(std::string name, uint64_t iterations, const RouteT& route, const base_req& proto) {
+    measure(std::move(name), iterations, [&](uint64_t n) {
+        run_task([&]() -> task<void> {
+            for (uint64_t i = 0; i < n; ++i) {
+                auto req = proto;
+                auto res = co_await route(std::move(req), Resp(null_send));
+                do_not_optimize(res);
+            }
+        }());
+    });
+}
+
+template<size_t N>
+void bench_table(uint64_t iterations) {
+    auto table = make_table<N>();
+    auto size = std::to_string(N);
+
+    auto first = std::string(std::string_view(route_path<0>()));
+    auto last = std::string(std::string_view(route_path<N - 1>()));
+
+    for (auto& [label, path] : {std::pair{"first", first},
+                                std::pair{"last", last},
+                                std::pair{"miss", std::string("/nothing/here")}}) {
+        measure("group_match/" + size + "/" + label, iterations, [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i) {
+                auto res = table.match(http::verb::get, path);
+                do_not_optimize(res);
+            }
+        });
+    }
+
+    bench_dispatch("group_dispatch/" + size + "/last",
+                   iterations,
+                   table,
+                   make_request(http::verb::get, last));
+}
+
+void run(uint64_t iterations) {
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "{\n  \"benchmarks\": [\n";
+
+    auto proto = make_request(http::verb::get, "/user/42/posts/7");
+
+    // Baseline: every dispatch benchmark copies a request.
+    measure("request_copy", iterations, [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; ++i) {
+            auto req = proto;
+            do_not_optimize(req);
+        }
+    });
+
+    auto literal = get<"/hello">(noop_handler);
+    measure("binding_match/literal", iterations, [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; ++i) {
+            auto res = literal.match(http::verb::get, "/hello");
+            do_not_optimize(res);
+        }
+    });
+
+    auto params = get<"/user/:id/posts/:post">(noop_handler);
+    measure("binding_match/params", iterations, [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; ++i) {
+            auto res = params.match(http::verb::get, "/user/42/posts/7");
+            do_not_optimize(res);
+        }
+    });
+
+    // Regex match plus filling the params object.
+    bench_dispatch("binding_dispatch/params", iterations, params, proto);
+
+    auto nested = bind<"/user/:id">(group(get<"/name">(noop_handler),
+                                          get<"/posts/:post">(noop_handler)));
+    bench_dispatch("binding_dispatch/nested", iterations, nested, proto);
+
+    bench_dispatch("end_point_dispatch/direct",
+                   iterations,
+                   get(noop_handler),
+                   make_request(http::verb::get, ""));
+
+    any_routable<base_req, any_response> erased(get(noop_handler));
+    bench_dispatch<decltype(erased), any_response>(
+        "end_point_dispatch/any_routable", iterations, erased, make_request(http::verb::get, ""));
+
+    auto with_mw = use(not_found_mw, params);
+    bench_dispatch("middleware_dispatch/not_found_mw", iterations, with_mw, proto);
+
+    bench_table<10>(iterations);
+    bench_table<100>(iterations);
+    bench_table<1000>(iterations / 10);
+
+    std::cout << "\n  ]\n}\n";
+}
+} // namespace
+} // namespace v60::bench
+
+int main(int argc, char** argv) {
+    uint64_t iterations = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 200'000;
+    v60::bench::run(iterations);
+}
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <v60/async.hpp>
+#include <v60/fixed_string.hpp>
+#include <v60/request.hpp>
+#include <v60/response.hpp>
+#include <v60/routing.hpp>
+
+namespace v60 {
+/**
+ * Whether v60 was built with V60_TRACK_ALLOCS. Without it, the functions below
+ * report zeroes and alloc_stage_mw does nothing.
+ */
+#if defined(V60_TRACK_ALLOCS)
+inline constexpr bool tracking_allocations = true;
+#else
+inline constexpr bool tracking_allocations = false;
+#endif
+
+struct alloc_stats {
+    uint64_t count = 0;
+    uint64_t bytes = 0;
+
+    alloc_stats operator-(const alloc_stats& rhs) const {
+        return {count - rhs.count, bytes - rhs.bytes};
+    }
+};
+
+/**
+ * Heap allocations made by the calling thread so far.
+ */
+alloc_stats thread_allocations();
+
+/**
+ * Heap allocations made by every thread so far, except the ones that opted out
+ * through untrack_allocations_on_this_thread.
+ */
+alloc_stats total_allocations();
+
+/**
+ * Stops counting the allocations of the calling thread, e.g. a load generator
+ * running in the same process as the server.
+ */
+void untrack_allocations_on_this_thread();
+
+struct alloc_stage_stats {
+    std::string name;
+    uint64_t requests;
+    alloc_stats allocs;
+};
+
+/**
+ * Totals of every stage that saw a request so far. The server records the
+ * whole of each request under "request", alloc_stage_mw adds the others.
+ */
+std::vector<alloc_stage_stats> allocation_stages();
+
+/**
+ * The stages in the Prometheus text format.
+ */
+std::string allocation_metrics();
+
+namespace detail {
+struct alloc_stage {
+    std::atomic<uint64_t> requests{0};
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> bytes{0};
+
+    void record(alloc_stats stats) {
+        requests.fetch_add(1, std::memory_order_relaxed);
+        count.fetch_add(stats.count, std::memory_order_relaxed);
+        bytes.fetch_add(stats.bytes, std::memory_order_relaxed);
+    }
+};
+
+/**
+ * Returns the stage with the given name, creating it on first use. The
+ * reference stays valid for the lifetime of the program.
+ */
+alloc_stage& get_alloc_stage(std::string_view name);
+
+/**
+ * Records the allocations made on the calling thread from construction to
+ * destruction.
+ *
+ * Coroutines give up the thread when they suspend, so anything else that runs
+ * on it in the meantime is counted as well. The numbers are exact with one
+ * connection at a time and an upper bound otherwise.
+ */
+class alloc_scope {
+public:
+    explicit alloc_scope(alloc_stage& stage)
+        : m_stage{stage}
+        , m_begin{thread_allocations()} {
+    }
+
+    alloc_scope(const alloc_scope&) = delete;
+
+    ~alloc_scope() {
+        m_stage.record(thread_allocations() - m_begin);
+    }
+
+private:
+    alloc_stage& m_stage;
+    alloc_stats m_begin;
+};
+} // namespace detail
+
+/**
+ * Records the allocations made by the wrapped routes, and everything they call,
+ * as the given stage:
+ *
+ *     use(alloc_stage_mw<"json">, use(object_body<...>, post<"/age">(...)))
+ *
+ * Nested stages include their inner stages, the difference between the two is
+ * what the middleware in between costs.
+ */
+template<fixed_string Name>
+inline constexpr auto alloc_stage_mw =
+    [](Request auto req, Response auto resp, Routable auto& next) -> task<bool> {
+    if constexpr (tracking_allocations) {
+        static auto& stage = detail::get_alloc_stage(std::string_view(Name));
+        detail::alloc_scope scope{stage};
+        co_return co_await next(std::move(req), std::move(resp));
+    } else {
+        co_return co_await next(std::move(req), std::move(resp));
+    }
+};
+
+/**
+ * Serves allocation_metrics, i.e. get<"/metrics">(alloc_metrics).
+ */
+inline constexpr auto alloc_metrics = [](Request auto, Response auto resp) -> task<void> {
+    resp.content_type("text/plain; version=0.0.4");
+    co_await resp.send(allocation_metrics());
+};
+} // namespace v60
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace v60 {
+/**
+ * Cancellation state of a single request. It's cancelled when the client goes
+ * away or a timeout_mw gives up on the request. Handlers can poll it, or
+ * register callbacks to abort whatever they are waiting on.
+ *
+ * Watching the connection for a disconnect costs a read, so the session only
+ * starts doing it once somebody registers a callback.
+ */
+class cancellation : public std::enable_shared_from_this<cancellation> {
+public:
+    class registration {
+    public:
+        registration() = default;
+
+        registration(std::shared_ptr<cancellation> state, int id)
+            : m_state{std::move(state)}
+            , m_id{id} {
+        }
+
+        registration(registration&& rhs) noexcept
+            : m_state{std::move(rhs.m_state)}
+            , m_id{rhs.m_id} {
+        }
+
+        registration& operator=(registration&& rhs) noexcept {
+            reset();
+            m_state = std::move(rhs.m_state);
+            m_id = rhs.m_id;
+            return *this;
+        }
+
+        ~registration() {
+            reset();
+        }
+
+        void reset() {
+            if (m_state) {
+                m_state->remove(m_id);
+                m_state.reset();
+            }
+        }
+
+    private:
+        std::shared_ptr<cancellation> m_state;
+        int m_id = 0;
+    };
+
+    bool cancelled() const noexcept {
+        return m_cancelled.load(std::memory_order_acquire);
+    }
+
+    /**
+     * Calls fn once the request is cancelled, or right away if it already is.
+     * The callback may run on any thread. It's unregistered once the returned
+     * object is destroyed.
+     */
+    [[nodiscard]] registration on_cancel(std::function<void()> fn);
+
+    void cancel();
+
+    /**
+     * Called by the session, fn runs when the first callback is registered.
+     */
+    void on_first_listener(std::function<void()> fn);
+
+    /**
+     * Gets the object ready for another request.
+     */
+    void reset();
+
+private:
+    void remove(int id);
+
+    std::atomic<bool> m_cancelled{false};
+
+    std::mutex m_mutex;
+    std::vector<std::pair<int, std::function<void()>>> m_callbacks;
+    int m_next_id = 1;
+    std::function<void()> m_first_listener;
+};
+} // namespace v60
@@ -0,0 +1,256 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <v60/async.hpp>
+#include <v60/fixed_string.hpp>
+#include <v60/request.hpp>
+#include <v60/response.hpp>
+#include <v60/routing.hpp>
+
+namespace v60 {
+struct limiter_options {
+    int initial_limit = 20;
+    int min_limit = 1;
+    int max_limit = 1000;
+
+    // How quickly the limit follows the computed target, in (0, 1].
+    double smoothing = 0.2;
+
+    // Latency samples are aggregated over windows of at least this long and
+    // this many requests before the limit is adjusted.
+    std::chrono::milliseconds window{100};
+    int min_window_samples = 10;
+
+    // Value of the Retry-After header for shed requests.
+    std::chrono::seconds retry_after{1};
+};
+
+/**
+ * A gradient based concurrency limiter. It compares the average latency of
+ * the latest window to a slowly moving long term average: while latency
+ * stays flat, the limit grows by about sqrt(limit) per window, once a queue
+ * starts to build up, latency grows and the limit shrinks proportionally.
+ *
+ * All state is kept in atomics, the hot path is a couple of fetch_adds. The
+ * update at the end of a window is done by whichever thread wins the race
+ * for it.
+ */
+class concurrency_limiter {
+public:
+    explicit concurrency_limiter(limiter_options opts = {});
+
+    /**
+     * Returns false if the request should be shed. Every successful call must
+     * be paired with a release.
+     */
+    bool try_acquire();
+
+    void release(std::chrono::nanoseconds latency);
+
+    int limit() const {
+        return m_limit.load(std::memory_order_relaxed);
+    }
+
+    int inflight() const {
+        return m_inflight.load(std::memory_order_relaxed);
+    }
+
+    const limiter_options& options() const {
+        return m_opts;
+    }
+
+private:
+    void end_window();
+
+    limiter_options m_opts;
+
+    std::atomic<int> m_inflight{0};
+    std::atomic<int> m_limit;
+
+    std::atomic<int64_t> m_window_start;
+    std::atomic<int64_t> m_window_latency_sum{0};
+    std::atomic<int64_t> m_window_samples{0};
+    std::atomic<int> m_window_max_inflight{0};
+
+    // Long term average of the window latencies, in nanoseconds. 0 until the
+    // first window completes.
+    std::atomic<int64_t> m_long_latency{0};
+};
+
+namespace detail {
+struct limiter_guard {
+    explicit limiter_guard(concurrency_limiter& limiter)
+        : m_limiter{limiter} {
+    }
+
+    limiter_guard(const limiter_guard&) = delete;
+
+    ~limiter_guard() {
+        m_limiter.release(std::chrono::steady_clock::now() - m_begin);
+    }
+
+    concurrency_limiter& m_limiter;
+    std::chrono::steady_clock::time_point m_begin = std::chrono::steady_clock::now();
+};
+} // namespace detail
+
+/**
+ * Sheds load before it reaches the wrapped routes. Requests over the current
+ * concurrency limit are answered right away with a 503, so place it outside of
+ * any expensive middleware, such as object_body:
+ *
+ *     use(concurrency_limit_mw(), use(object_body<...>, post<"/foo">(...)))
+ *
+ * Every instance adapts its own limit, wrap routes separately to get per route
+ * limits.
+ */
+struct concurrency_limit_mw {
+    explicit concurrency_limit_mw(limiter_options opts = {})
+        : m_limiter{std::make_shared<concurrency_limiter>(opts)} {
+    }
+
+    template<Request Req, Response Resp, Routable Next>
+    task<bool> operator()(Req req, Resp resp, const Next& next) const {
+        auto& limiter = *m_limiter;
+        if (!limiter.try_acquire()) {
+            resp.status(503);
+            resp.header("retry-after",
+                        std::to_string(limiter.options().retry_after.count()));
+            co_await resp.send("Service unavailable");
+            co_return false;
+        }
+
+        detail::limiter_guard guard{limiter};
+        co_return co_await next(std::move(req), std::move(resp));
+    }
+
+    std::shared_ptr<concurrency_limiter> m_limiter;
+};
+
+struct rate_limit_options {
+    // Sustained rate, in requests per second.
+    double rate = 10;
+
+    // Number of requests a client can make back to back.
+    int burst = 20;
+
+    // Upper bound on the number of keys tracked at once. Rounded up to a
+    // multiple of the shard size.
+    size_t capacity = 1 << 16;
+};
+
+struct rate_limit_decision {
+    bool allowed;
+
+    // Requests left in the burst after this one.
+    int remaining;
+
+    // Time until the bucket is full again.
+    std::chrono::microseconds reset;
+
+    // Time until the next request would be allowed, 0 if this one was.
+    std::chrono::microseconds retry_after;
+};
+
+/**
+ * A fixed size table of token buckets.
+ *
+ * Buckets are kept as a single "theoretical arrival time", as in GCRA, which
+ * behaves exactly like a token bucket refilled lazily from the monotonic
+ * clock, but fits in a word. Keys hash into small cache line sized shards,
+ * every bucket update is a single CAS, and there are no locks.
+ *
+ * When a shard is full, a bucket that has refilled completely is reused first,
+ * since forgetting it is indistinguishable from keeping it. Otherwise the least
+ * recently used bucket of the shard is evicted.
+ */
+class rate_limiter {
+public:
+    explicit rate_limiter(rate_limit_options opts = {});
+
+    rate_limit_decision acquire(std::string_view key);
+
+    const rate_limit_options& options() const {
+        return m_opts;
+    }
+
+private:
+    static constexpr int shard_ways = 4;
+
+    struct alignas(64) shard {
+        std::atomic<uint64_t> keys[shard_ways];
+        std::atomic<uint64_t> states[shard_ways];
+    };
+
+    int claim(shard& s, uint64_t hash, int64_t now);
+
+    rate_limit_options m_opts;
+    int64_t m_interval;
+    int64_t m_tolerance;
+    std::chrono::steady_clock::time_point m_epoch;
+    size_t m_shard_mask;
+    std::unique_ptr<shard[]> m_shards;
+};
+
+/**
+ * Rate limiting key: the address of the client.
+ */
+struct by_client {
+    std::string_view operator()(const base_request& req) const {
+        return req.remote_address();
+    }
+};
+
+/**
+ * Rate limiting key: the value of the given header. Requests without it share
+ * a single bucket.
+ */
+template<fixed_string Name>
+struct by_header {
+    std::string_view operator()(const base_request& req) const {
+        return req.header(std::string_view(Name)).value_or(std::string_view{});
+    }
+};
+
+/**
+ * Rejects requests over a per key request rate with a 429, along with the
+ * RateLimit-* headers of draft-ietf-httpapi-ratelimit-headers:
+ *
+ *     use(rate_limit_mw<by_header<"x-api-key">>({.rate = 5, .burst = 10}), api)
+ */
+template<class KeyFn = by_client>
+struct rate_limit_mw {
+    explicit rate_limit_mw(rate_limit_options opts = {}, KeyFn key_fn = {})
+        : m_limiter{std::make_shared<rate_limiter>(opts)}
+        , m_key_fn{std::move(key_fn)} {
+    }
+
+    template<Request Req, Response Resp, Routable Next>
+    task<bool> operator()(Req req, Resp resp, const Next& next) const {
+        auto decision = m_limiter->acquire(m_key_fn(req));
+        if (!decision.allowed) {
+            auto seconds = [](std::chrono::microseconds us) {
+                return std::to_string((us.count() + 999'999) / 1'000'000);
+            };
+
+            resp.status(429);
+            resp.header("ratelimit-limit", std::to_string(m_limiter->options().burst));
+            resp.header("ratelimit-remaining", "0");
+            resp.header("ratelimit-reset", seconds(decision.reset));
+            resp.header("retry-after", seconds(decision.retry_after));
+            co_await resp.send("Too many requests");
+            co_return false;
+        }
+
+        co_return co_await next(std::move(req), std::move(resp));
+    }
+
+    std::shared_ptr<rate_limiter> m_limiter;
+    KeyFn m_key_fn;
+};
+} // namespace v60
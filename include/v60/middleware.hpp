@@ -38,11 +38,13 @@ auto object_body = [](Request auto req, Response auto resp, Routable auto& next)
     using namespace simdjson;
     using namespace simdjson::builtin; // for ondemand
     ondemand::parser parser;
-    ondemand::document elems = parser.iterate(req.body);
+    padded_string json(req.body);
+    ondemand::document elems = parser.iterate(json);
 
     ObjT body;
     body.for_each_member([&]<auto key>(auto& mem) {
-        mem = elems[std::string_view(key)]; //.get<decltype(mem)>();
+        using MemT = std::remove_reference_t<decltype(mem)>;
+        mem = MemT(elems[std::string_view(key)].template get<MemT>().value());
     });
 
     return next(std::move(req).with_body(std::move(body)), std::move(resp));
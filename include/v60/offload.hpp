@@ -0,0 +1,76 @@
+#pragma once
+
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/this_coro.hpp>
+#include <boost/asio/thread_pool.hpp>
+#include <boost/asio/use_awaitable.hpp>
+#include <v60/async.hpp>
+#include <v60/meta.hpp>
+#include <v60/request.hpp>
+#include <v60/response.hpp>
+
+namespace v60 {
+/**
+ * The pool cpu_bound handlers run on by default, with one thread per core. It
+ * is created on first use.
+ */
+boost::asio::thread_pool& cpu_pool();
+
+template<class FnT>
+class cpu_bound_fn {
+public:
+    cpu_bound_fn(FnT fn, boost::asio::thread_pool& pool)
+        : m_fn{std::move(fn)}
+        , m_pool{&pool} {
+    }
+
+    template<Request Req, Response Resp>
+    task<void> operator()(Req req, Resp resp) const {
+        namespace net = boost::asio;
+        auto session = co_await net::this_coro::executor;
+
+        // Writes must happen on the session's executor, not the pool.
+        auto offloaded = std::move(resp).wrap_sender([session](auto send) {
+            return [session, send = std::move(send)](http::str_response msg)
+                       -> task<void> {
+                co_await net::co_spawn(session, send(std::move(msg)), net::use_awaitable);
+            };
+        });
+
+        // The session is resumed on its own executor once the handler is done.
+        co_await net::co_spawn(m_pool->get_executor(),
+                               run(std::move(req), std::move(offloaded)),
+                               net::use_awaitable);
+    }
+
+private:
+    template<Request Req, Response Resp>
+    task<void> run(Req req, Resp resp) const {
+        static constexpr auto is_coroutine =
+            meta::awaitable<decltype(m_fn(std::move(req), std::move(resp)))>;
+
+        if constexpr (is_coroutine) {
+            co_await m_fn(std::move(req), std::move(resp));
+        } else {
+            m_fn(std::move(req), std::move(resp));
+        }
+    }
+
+    FnT m_fn;
+    boost::asio::thread_pool* m_pool;
+};
+
+/**
+ * Runs the given handler on a separate thread pool so that CPU heavy work does
+ * not hold up the I/O threads and every other connection on them:
+ *
+ *     get<"/report">(cpu_bound([](Request auto req, Response auto resp) -> task<void> {
+ *         auto report = crunch_numbers();
+ *         co_await resp.send(std::move(report));
+ *     }));
+ */
+template<class FnT>
+auto cpu_bound(FnT&& fn, boost::asio::thread_pool& pool = cpu_pool()) {
+    return cpu_bound_fn<std::decay_t<FnT>>{std::forward<FnT>(fn), pool};
+}
+} // namespace v60
@@ -1,7 +1,10 @@
 #pragma once
 
+#include <chrono>
+#include <memory>
 #include <optional>
 #include <string_view>
+#include <v60/cancel.hpp>
 #include <v60/http.hpp>
 #include <v60/meta.hpp>
 #include <v60/object.hpp>
@@ -9,9 +12,16 @@
 namespace v60 {
 class base_request {
 public:
-    explicit base_request(http::str_request&& raw)
-        : m_raw{std::move(raw)} {
+    explicit base_request(http::str_request&& raw,
+                          std::string_view remote = {},
+                          std::shared_ptr<cancellation> cancel = {})
+        : m_raw{std::move(raw)}
+        , m_remote{remote}
+        , m_cancel{std::move(cancel)} {
         m_remaining = path();
+        if (!m_cancel) {
+            m_cancel = std::make_shared<cancellation>();
+        }
     }
 
     std::string_view path() const {
@@ -30,6 +40,40 @@ public:
         return m_raw.version();
     }
 
+    /**
+     * Address of the peer that sent this request, empty if it's not known.
+     */
+    std::string_view remote_address() const {
+        return m_remote;
+    }
+
+    /**
+     * The point in time after which nobody will use the response anymore.
+     * Unbounded unless a timeout_mw sets it.
+     */
+    std::chrono::steady_clock::time_point deadline() const {
+        return m_deadline;
+    }
+
+    void deadline(std::chrono::steady_clock::time_point deadline) {
+        m_deadline = deadline;
+    }
+
+    bool cancelled() const {
+        return m_cancel->cancelled();
+    }
+
+    /**
+     * Calls fn when the request gets cancelled, see cancellation::on_cancel.
+     */
+    [[nodiscard]] cancellation::registration on_cancel(std::function<void()> fn) const {
+        return m_cancel->on_cancel(std::move(fn));
+    }
+
+    const std::shared_ptr<cancellation>& cancel_state() const {
+        return m_cancel;
+    }
+
     http::verb method() const {
         return m_raw.method();
     }
@@ -46,6 +90,10 @@ public:
 private:
     std::string_view m_remaining;
     http::str_request m_raw;
+    std::string_view m_remote;
+    std::shared_ptr<cancellation> m_cancel;
+    std::chrono::steady_clock::time_point m_deadline =
+        std::chrono::steady_clock::time_point::max();
 };
 
 template<Object Params = object<>, class Body = object<>, class... Mixins>
@@ -51,7 +51,21 @@ public:
                    boost::string_view(value.data(), value.size()));
     }
 
+    /**
+     * Returns a response with the same state whose sender is wrap(sender).
+     */
+    template<class WrapT>
+    auto wrap_sender(WrapT&& wrap) && {
+        using NewSenderT = decltype(wrap(std::move(m_send)));
+        response<NewSenderT> res(wrap(std::move(m_send)));
+        res.m_resp = std::move(m_resp);
+        return res;
+    }
+
 private:
+    template<class>
+    friend class response;
+
     SenderT m_send;
     http::str_response m_resp;
 };
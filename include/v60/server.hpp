@@ -1,5 +1,6 @@
 #pragma once
 
+#include <chrono>
 #include <functional>
 #include <v60/async.hpp>
 #include <v60/request.hpp>
@@ -14,9 +15,25 @@ public:
 
     ~server();
 
+    /**
+     * Serves requests on the given port until the server is stopped, either
+     * through a call to stop or by receiving SIGINT/SIGTERM.
+     */
     void listen(int port);
 
+    /**
+     * Starts a graceful shutdown. The acceptors are closed, idle keep-alive
+     * connections are dropped and busy ones get a `Connection: close` on
+     * their current response. Once every connection is drained, or the
+     * deadline passes, the I/O threads are stopped and listen returns.
+     *
+     * It's safe to call this from any thread, including from a handler.
+     */
+    void stop(std::chrono::steady_clock::time_point deadline);
+
+    void stop(std::chrono::steady_clock::duration grace = std::chrono::seconds(10));
+
 private:
     std::unique_ptr<server_impl> m_impl;
 };
-} // namespace v60
\ No newline at end of file
+} // namespace v60
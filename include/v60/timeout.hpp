@@ -0,0 +1,105 @@
+#pragma once
+
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/redirect_error.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/this_coro.hpp>
+#include <boost/asio/use_awaitable.hpp>
+#include <chrono>
+#include <exception>
+#include <v60/async.hpp>
+#include <v60/request.hpp>
+#include <v60/response.hpp>
+#include <v60/routing.hpp>
+
+namespace v60 {
+namespace detail {
+struct timeout_state {
+    explicit timeout_state(boost::asio::any_io_executor ex)
+        : timer{std::move(ex)} {
+    }
+
+    boost::asio::steady_timer timer;
+    std::atomic<bool> responded{false};
+    bool done = false;
+    bool result = false;
+    std::exception_ptr error;
+};
+} // namespace detail
+
+/**
+ * Gives the wrapped routes Ms milliseconds to respond. After that, the request
+ * is cancelled and a 504 is sent, unless the client is already gone. Anything
+ * the handler sends afterwards is dropped.
+ *
+ * Handlers can't be interrupted at arbitrary points, they are expected to
+ * check req.cancelled() or abort their work from req.on_cancel(). The
+ * connection is closed after a 504, the next request does not wait on a
+ * handler that's winding down.
+ */
+template<int64_t Ms>
+inline constexpr auto timeout_mw =
+    [](Request auto req, Response auto resp, Routable auto& next) -> task<bool> {
+    namespace net = boost::asio;
+
+    auto deadline =
+        std::min(req.deadline(), std::chrono::steady_clock::now() + std::chrono::milliseconds(Ms));
+    req.deadline(deadline);
+
+    auto state = std::make_shared<detail::timeout_state>(co_await net::this_coro::executor);
+    auto cancel = req.cancel_state();
+
+    // Disconnects and outer timeouts wake us up as well.
+    auto registration = req.on_cancel([state] {
+        net::post(state->timer.get_executor(), [state] { state->timer.cancel(); });
+    });
+
+    auto resp_bak = resp;
+    auto guarded = std::move(resp).wrap_sender([state](auto send) -> any_send {
+        return [state, send = std::move(send)](http::str_response msg) -> task<void> {
+            if (state->responded.exchange(true)) {
+                co_return;
+            }
+            co_await send(std::move(msg));
+        };
+    });
+
+    net::co_spawn(state->timer.get_executor(),
+                  next(std::move(req), std::move(guarded)),
+                  [state](std::exception_ptr err, bool res) {
+                      state->error = err;
+                      state->result = res;
+                      state->done = true;
+                      state->timer.cancel();
+                  });
+
+    boost::system::error_code ec;
+    state->timer.expires_at(deadline);
+    co_await state->timer.async_wait(net::redirect_error(net::use_awaitable, ec));
+
+    if (state->done) {
+        if (state->error) {
+            std::rethrow_exception(state->error);
+        }
+        co_return state->result;
+    }
+
+    auto disconnected = cancel->cancelled();
+    cancel->cancel();
+
+    if (!disconnected && !state->responded.exchange(true)) {
+        resp_bak.status(504);
+        resp_bak.header("connection", "close");
+        co_await resp_bak.send("Gateway timeout");
+    }
+
+    // The handler still holds references into the session, wait for it to
+    // wind down.
+    while (!state->done) {
+        state->timer.expires_at(net::steady_timer::time_point::max());
+        co_await state->timer.async_wait(net::redirect_error(net::use_awaitable, ec));
+    }
+
+    co_return false;
+};
+} // namespace v60
@@ -1,7 +1,11 @@
 #pragma once
 
+#include <v60/alloc.hpp>
 #include <v60/async.hpp>
 #include <v60/end_point.hpp>
 #include <v60/group.hpp>
+#include <v60/limit.hpp>
 #include <v60/middleware.hpp>
-#include <v60/server.hpp>
\ No newline at end of file
+#include <v60/offload.hpp>
+#include <v60/server.hpp>
+#include <v60/timeout.hpp>
\ No newline at end of file
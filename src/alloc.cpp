@@ -0,0 +1,141 @@
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <sstream>
+#include <v60/alloc.hpp>
+
+namespace v60 {
+namespace {
+// Plain thread locals, so that counting doesn't allocate or take locks.
+thread_local uint64_t t_allocs = 0;
+thread_local uint64_t t_alloc_bytes = 0;
+thread_local bool t_untracked = false;
+
+std::atomic<uint64_t> g_allocs{0};
+std::atomic<uint64_t> g_alloc_bytes{0};
+
+struct stage_registry {
+    std::mutex mutex;
+    std::map<std::string, std::unique_ptr<detail::alloc_stage>, std::less<>> stages;
+};
+
+stage_registry& registry() {
+    static stage_registry reg;
+    return reg;
+}
+} // namespace
+
+alloc_stats thread_allocations() {
+    return {t_allocs, t_alloc_bytes};
+}
+
+alloc_stats total_allocations() {
+    return {g_allocs.load(std::memory_order_relaxed),
+            g_alloc_bytes.load(std::memory_order_relaxed)};
+}
+
+void untrack_allocations_on_this_thread() {
+    t_untracked = true;
+}
+
+std::vector<alloc_stage_stats> allocation_stages() {
+    auto& reg = registry();
+    std::lock_guard lock{reg.mutex};
+
+    std::vector<alloc_stage_stats> res;
+    res.reserve(reg.stages.size());
+    for (auto& [name, stage] : reg.stages) {
+        res.push_back({name,
+                       stage->requests.load(std::memory_order_relaxed),
+                       {stage->count.load(std::memory_order_relaxed),
+                        stage->bytes.load(std::memory_order_relaxed)}});
+    }
+    return res;
+}
+
+std::string allocation_metrics() {
+    auto stages = allocation_stages();
+    auto total = total_allocations();
+
+    std::ostringstream os;
+    os << "# TYPE v60_allocs_total counter\n"
+       << "v60_allocs_total " << total.count << '\n'
+       << "# TYPE v60_alloc_bytes_total counter\n"
+       << "v60_alloc_bytes_total " << total.bytes << '\n';
+
+    os << "# TYPE v60_alloc_stage_requests_total counter\n";
+    for (auto& stage : stages) {
+        os << "v60_alloc_stage_requests_total{stage=\"" << stage.name << "\"} "
+           << stage.requests << '\n';
+    }
+    os << "# TYPE v60_alloc_stage_allocs_total counter\n";
+    for (auto& stage : stages) {
+        os << "v60_alloc_stage_allocs_total{stage=\"" << stage.name << "\"} "
+           << stage.allocs.count << '\n';
+    }
+    os << "# TYPE v60_alloc_stage_bytes_total counter\n";
+    for (auto& stage : stages) {
+        os << "v60_alloc_stage_bytes_total{stage=\"" << stage.name << "\"} "
+           << stage.allocs.bytes << '\n';
+    }
+    return os.str();
+}
+
+namespace detail {
+alloc_stage& get_alloc_stage(std::string_view name) {
+    auto& reg = registry();
+    std::lock_guard lock{reg.mutex};
+
+    auto it = reg.stages.find(name);
+    if (it == reg.stages.end()) {
+        it = reg.stages.emplace(std::string(name), std::make_unique<alloc_stage>()).first;
+    }
+    return *it->second;
+}
+} // namespace detail
+
+#if defined(V60_TRACK_ALLOCS)
+namespace {
+void* counted_alloc(std::size_t size) {
+    if (!t_untracked) {
+        ++t_allocs;
+        t_alloc_bytes += size;
+        g_allocs.fetch_add(1, std::memory_order_relaxed);
+        g_alloc_bytes.fetch_add(size, std::memory_order_relaxed);
+    }
+    if (auto ptr = std::malloc(size ? size : 1)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+} // namespace
+#endif
+} // namespace v60
+
+#if defined(V60_TRACK_ALLOCS)
+void* operator new(std::size_t size) {
+    return v60::counted_alloc(size);
+}
+
+void* operator new[](std::size_t size) {
+    return v60::counted_alloc(size);
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+#endif
@@ -0,0 +1,73 @@
+#include <v60/cancel.hpp>
+#include <v60/end_point.hpp>
+#include <v60/middleware.hpp>
+#include <v60/timeout.hpp>
+
+namespace v60 {
+cancellation::registration cancellation::on_cancel(std::function<void()> fn) {
+    std::function<void()> first_listener;
+    int id;
+    {
+        std::lock_guard lock{m_mutex};
+        if (!cancelled()) {
+            id = m_next_id++;
+            m_callbacks.emplace_back(id, std::move(fn));
+            first_listener = std::exchange(m_first_listener, nullptr);
+        } else {
+            id = 0;
+        }
+    }
+
+    if (id == 0) {
+        fn();
+        return {};
+    }
+
+    if (first_listener) {
+        first_listener();
+    }
+
+    return {shared_from_this(), id};
+}
+
+void cancellation::cancel() {
+    decltype(m_callbacks) callbacks;
+    {
+        std::lock_guard lock{m_mutex};
+        if (m_cancelled.exchange(true, std::memory_order_acq_rel)) {
+            return;
+        }
+        callbacks = std::move(m_callbacks);
+        m_first_listener = nullptr;
+    }
+
+    for (auto& [id, fn] : callbacks) {
+        fn();
+    }
+}
+
+void cancellation::on_first_listener(std::function<void()> fn) {
+    std::lock_guard lock{m_mutex};
+    m_first_listener = std::move(fn);
+}
+
+void cancellation::reset() {
+    std::lock_guard lock{m_mutex};
+    m_cancelled.store(false, std::memory_order_release);
+    m_callbacks.clear();
+    m_first_listener = nullptr;
+}
+
+void cancellation::remove(int id) {
+    std::lock_guard lock{m_mutex};
+    std::erase_if(m_callbacks, [id](auto& cb) { return cb.first == id; });
+}
+
+namespace {
+inline auto sample() {
+    return use(timeout_mw<100>, get<"/foo">([](const Request auto&, const Response auto&) {}));
+}
+
+static_assert(Routable<decltype(sample())>);
+} // namespace
+} // namespace v60
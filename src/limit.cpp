@@ -0,0 +1,203 @@
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <functional>
+#include <v60/end_point.hpp>
+#include <v60/limit.hpp>
+#include <v60/middleware.hpp>
+
+namespace v60 {
+namespace {
+int64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+} // namespace
+
+concurrency_limiter::concurrency_limiter(limiter_options opts)
+    : m_opts{opts}
+    , m_limit{std::clamp(opts.initial_limit, opts.min_limit, opts.max_limit)}
+    , m_window_start{now_ns()} {
+}
+
+bool concurrency_limiter::try_acquire() {
+    auto current = m_inflight.fetch_add(1, std::memory_order_relaxed) + 1;
+    if (current > m_limit.load(std::memory_order_relaxed)) {
+        m_inflight.fetch_sub(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    auto max = m_window_max_inflight.load(std::memory_order_relaxed);
+    while (max < current && !m_window_max_inflight.compare_exchange_weak(
+                                max, current, std::memory_order_relaxed)) {
+    }
+    return true;
+}
+
+void concurrency_limiter::release(std::chrono::nanoseconds latency) {
+    m_inflight.fetch_sub(1, std::memory_order_relaxed);
+    m_window_latency_sum.fetch_add(latency.count(), std::memory_order_relaxed);
+    auto samples = m_window_samples.fetch_add(1, std::memory_order_relaxed) + 1;
+
+    if (samples < m_opts.min_window_samples) {
+        return;
+    }
+
+    auto now = now_ns();
+    auto start = m_window_start.load(std::memory_order_relaxed);
+    if (now - start < std::chrono::nanoseconds(m_opts.window).count()) {
+        return;
+    }
+
+    // Only one thread gets to close the window.
+    if (m_window_start.compare_exchange_strong(start, now, std::memory_order_relaxed)) {
+        end_window();
+    }
+}
+
+void concurrency_limiter::end_window() {
+    auto sum = m_window_latency_sum.exchange(0, std::memory_order_relaxed);
+    auto samples = m_window_samples.exchange(0, std::memory_order_relaxed);
+    auto max_inflight = m_window_max_inflight.exchange(0, std::memory_order_relaxed);
+
+    if (samples == 0) {
+        return;
+    }
+
+    auto short_latency = static_cast<double>(sum) / samples;
+    auto long_latency = static_cast<double>(m_long_latency.load(std::memory_order_relaxed));
+    if (long_latency == 0) {
+        long_latency = short_latency;
+    } else {
+        // Follow the short term average slowly, so that a persistent increase
+        // eventually becomes the new normal instead of starving the route.
+        long_latency = long_latency * 0.95 + short_latency * 0.05;
+    }
+    m_long_latency.store(static_cast<int64_t>(long_latency), std::memory_order_relaxed);
+
+    double limit = m_limit.load(std::memory_order_relaxed);
+
+    // If we never came close to the limit, latency tells us nothing about it.
+    if (max_inflight < limit / 2 && short_latency <= long_latency) {
+        return;
+    }
+
+    auto gradient = std::clamp(long_latency / short_latency, 0.5, 1.0);
+    auto target = limit * gradient + std::sqrt(limit);
+    auto next = limit * (1 - m_opts.smoothing) + target * m_opts.smoothing;
+
+    auto rounded = static_cast<int>(next > limit ? std::ceil(next) : std::floor(next));
+    m_limit.store(std::clamp(rounded, m_opts.min_limit, m_opts.max_limit),
+                  std::memory_order_relaxed);
+}
+
+namespace {
+constexpr uint64_t tat_mask = (uint64_t(1) << 48) - 1;
+
+uint64_t pack(uint16_t tag, int64_t tat) {
+    return (uint64_t(tag) << 48) | (uint64_t(tat) & tat_mask);
+}
+
+uint16_t tag_of(uint64_t state) {
+    return static_cast<uint16_t>(state >> 48);
+}
+
+int64_t tat_of(uint64_t state) {
+    return static_cast<int64_t>(state & tat_mask);
+}
+} // namespace
+
+rate_limiter::rate_limiter(rate_limit_options opts)
+    : m_opts{opts}
+    , m_interval{std::max<int64_t>(1, static_cast<int64_t>(1'000'000 / opts.rate))}
+    , m_tolerance{m_interval * std::max(1, opts.burst)}
+    , m_epoch{std::chrono::steady_clock::now()} {
+    auto shards = std::bit_ceil(std::max<size_t>(1, opts.capacity / shard_ways));
+    m_shard_mask = shards - 1;
+    m_shards = std::make_unique<shard[]>(shards);
+}
+
+int rate_limiter::claim(shard& s, uint64_t hash, int64_t now) {
+    for (;;) {
+        int victim = 0;
+        uint64_t victim_key = 0;
+        int64_t victim_score = INT64_MAX;
+        for (int i = 0; i < shard_ways; ++i) {
+            auto key = s.keys[i].load(std::memory_order_acquire);
+            if (key == hash) {
+                return i;
+            }
+
+            // A full bucket carries no information, it's as good as empty.
+            auto tat = tat_of(s.states[i].load(std::memory_order_relaxed));
+            auto score = key == 0 || tat <= now ? -1 : tat;
+            if (score < victim_score) {
+                victim = i;
+                victim_key = key;
+                victim_score = score;
+            }
+        }
+
+        // The tag in the state won't match ours, so the evicted bucket's state
+        // is treated as a full bucket by acquire.
+        if (s.keys[victim].compare_exchange_strong(
+                victim_key, hash, std::memory_order_acq_rel)) {
+            return victim;
+        }
+    }
+}
+
+rate_limit_decision rate_limiter::acquire(std::string_view key) {
+    auto hash = static_cast<uint64_t>(std::hash<std::string_view>{}(key));
+    hash = hash == 0 ? 1 : hash;
+    auto tag = static_cast<uint16_t>(hash >> 48);
+
+    auto& s = m_shards[hash & m_shard_mask];
+
+    auto now = std::chrono::duration_cast<std::chrono::microseconds>(
+                   std::chrono::steady_clock::now() - m_epoch)
+                   .count();
+
+    for (;;) {
+        auto slot = claim(s, hash, now);
+        auto state = s.states[slot].load(std::memory_order_acquire);
+        if (s.keys[slot].load(std::memory_order_acquire) != hash) {
+            // Evicted under our feet.
+            continue;
+        }
+
+        auto tat = tag_of(state) == tag ? std::max(tat_of(state), now) : now;
+        auto next_tat = tat + m_interval;
+
+        if (next_tat - now > m_tolerance) {
+            return {false,
+                    0,
+                    std::chrono::microseconds(tat - now),
+                    std::chrono::microseconds(next_tat - now - m_tolerance)};
+        }
+
+        if (s.states[slot].compare_exchange_weak(
+                state, pack(tag, next_tat), std::memory_order_acq_rel)) {
+            auto remaining = static_cast<int>((m_tolerance - (next_tat - now)) / m_interval);
+            return {true, remaining, std::chrono::microseconds(next_tat - now), {}};
+        }
+    }
+}
+
+namespace {
+inline auto sample() {
+    return use(concurrency_limit_mw(),
+               get<"/foo">([](const Request auto&, const Response auto&) {}));
+}
+
+static_assert(Routable<decltype(sample())>);
+
+inline auto rate_sample() {
+    return use(rate_limit_mw<by_header<"x-api-key">>(),
+               get<"/foo">([](const Request auto&, const Response auto&) {}));
+}
+
+static_assert(Routable<decltype(rate_sample())>);
+} // namespace
+} // namespace v60
@@ -0,0 +1,20 @@
+#include <thread>
+#include <v60/end_point.hpp>
+#include <v60/offload.hpp>
+
+namespace v60 {
+boost::asio::thread_pool& cpu_pool() {
+    static boost::asio::thread_pool pool(
+        std::max<int>(1, std::thread::hardware_concurrency()));
+    return pool;
+}
+
+namespace {
+inline auto sample() {
+    return get<"/foo">(
+        cpu_bound([](Request auto, Response auto resp) -> task<void> { co_return; }));
+}
+
+static_assert(Routable<decltype(sample())>);
+} // namespace
+} // namespace v60
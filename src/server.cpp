@@ -1,12 +1,22 @@
+#include <atomic>
 #include <boost/asio/co_spawn.hpp>
 #include <boost/asio/detached.hpp>
 #include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/redirect_error.hpp>
+#include <boost/asio/signal_set.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/strand.hpp>
 #include <boost/beast.hpp>
 #include <boost/beast/core/flat_buffer.hpp>
 #include <boost/beast/core/tcp_stream.hpp>
 #include <boost/beast/http.hpp>
+#include <csignal>
 #include <iostream>
+#include <mutex>
+#include <optional>
+#include <set>
 #include <thread>
+#include <v60/alloc.hpp>
 #include <v60/server.hpp>
 
 namespace v60 {
@@ -19,12 +29,57 @@ namespace net = boost::asio;    // from <boost/asio.hpp>
 void fail(beast::error_code ec, char const* what) {
     std::cerr << what << ": " << ec.message() << "\n";
 }
+
+/**
+ * State of a single client connection that the server needs to reach from
+ * outside of the session coroutine, i.e. while stopping or watching for a
+ * disconnect.
+ */
+struct connection {
+    explicit connection(tcp::socket&& socket)
+        : stream{std::move(socket)}
+        , watch_done{stream.get_executor()} {
+        beast::error_code ec;
+        auto endpoint = stream.socket().remote_endpoint(ec);
+        if (!ec) {
+            remote = endpoint.address().to_string();
+        }
+    }
+
+    beast::tcp_stream stream;
+    std::string remote;
+
+    beast::flat_buffer buffer;
+
+    // Whether the session is waiting for the next request. Only touched on
+    // the stream's strand.
+    bool idle = false;
+
+    // Cancellation state of the current request, reused when no one else
+    // holds on to it.
+    std::shared_ptr<cancellation> cancel;
+
+    // Whether there's a read pending to detect the client going away while a
+    // request is being handled. Only touched on the stream's strand.
+    bool watching = false;
+    net::steady_timer watch_done;
+};
 } // namespace
 
 struct server_impl {
     any_routable<request<object<>, std::string_view>, any_response> m_route;
     net::io_context m_ioc{static_cast<int>(std::thread::hardware_concurrency())};
 
+    std::atomic<bool> m_stopping{false};
+
+    std::mutex m_state_mutex;
+    std::vector<std::shared_ptr<tcp::acceptor>> m_acceptors;
+    std::set<std::shared_ptr<connection>> m_connections;
+
+    // Allocations from a parsed request being handed to the routes until its
+    // response is written, with V60_TRACK_ALLOCS.
+    detail::alloc_stage& m_request_allocs = detail::get_alloc_stage("request");
+
     server_impl(any_routable<request<object<>, std::string_view>, any_response> route)
         : m_route{std::move(route)} {
     }
@@ -32,6 +87,8 @@ struct server_impl {
     template<class Body, class Allocator, class Send>
     v60::task<void>
     handle_request(beast::http::request<Body, beast::http::basic_fields<Allocator>>&& req,
+                   std::string_view remote,
+                   std::shared_ptr<cancellation> cancel,
                    Send&& send) {
         // Returns a bad request response
         auto const bad_request = [&req](beast::string_view why) {
@@ -55,13 +112,14 @@ struct server_impl {
         auto body = req.body();
         const auto target = std::string(req.target());
         const auto verb = req.method();
+        const auto keep_alive = req.keep_alive();
         auto reqq = request<v60::object<>, std::string_view>{
-            base_request{std::move(req)}, {}, body};
+            base_request{std::move(req), remote, std::move(cancel)}, {}, body};
 
         beast::http::response<beast::http::string_body> res;
         res.set(beast::http::field::server, "v60_over_" BOOST_BEAST_VERSION_STRING);
         res.version(reqq.version());
-        res.keep_alive(req.keep_alive());
+        res.keep_alive(keep_alive);
 
         v60::any_response resp(send, std::move(res));
         const auto route_res = co_await m_route(std::move(reqq), std::move(resp));
@@ -71,12 +129,61 @@ struct server_impl {
         //}
     }
 
-    net::awaitable<void> do_session(beast::tcp_stream stream) {
+    /**
+     * Keeps a read pending on the connection while the current request is
+     * handled, so that it can be cancelled if the client hangs up. Any
+     * pipelined bytes it receives are kept for the next request.
+     */
+    void start_watch(std::shared_ptr<connection> conn, std::weak_ptr<cancellation> cancel) {
+        if (conn->watching || cancel.lock() != conn->cancel) {
+            return;
+        }
+        conn->watching = true;
+
+        boost::asio::co_spawn(
+            conn->stream.get_executor(),
+            [conn, cancel]() -> net::awaitable<void> {
+                beast::error_code ec;
+                auto n = co_await conn->stream.socket().async_read_some(
+                    conn->buffer.prepare(1024),
+                    net::redirect_error(net::use_awaitable, ec));
+                if (!ec) {
+                    conn->buffer.commit(n);
+                } else if (ec != net::error::operation_aborted) {
+                    if (auto state = cancel.lock()) {
+                        state->cancel();
+                    }
+                }
+                conn->watching = false;
+                conn->watch_done.cancel();
+            },
+            boost::asio::detached);
+    }
+
+    net::awaitable<void> stop_watch(connection& conn) {
+        if (!conn.watching) {
+            co_return;
+        }
+
+        beast::error_code ec;
+        conn.stream.socket().cancel(ec);
+        while (conn.watching) {
+            conn.watch_done.expires_at(net::steady_timer::time_point::max());
+            co_await conn.watch_done.async_wait(net::redirect_error(net::use_awaitable, ec));
+        }
+    }
+
+    net::awaitable<void> do_session(std::shared_ptr<connection> conn) {
+        auto& stream = conn->stream;
         bool close = false;
 
         auto lambda = [&]<bool isRequest, class Body, class Fields>(
                           beast::http::message<isRequest, Body, Fields> msg)
             -> net::awaitable<void> {
+            // While draining, finish the current exchange and hang up.
+            if (m_stopping) {
+                msg.keep_alive(false);
+            }
             close = msg.need_eof();
 
             // We need the serializer here because the serializer requires
@@ -87,15 +194,39 @@ struct server_impl {
             //        http::write(stream, sr);
         };
 
-        beast::flat_buffer buffer;
+        auto& buffer = conn->buffer;
 
         try {
-            for (;;) {
+            while (!m_stopping) {
                 beast::http::request<beast::http::string_body> req;
 
+                conn->idle = true;
                 co_await beast::http::async_read(stream, buffer, req, net::use_awaitable);
+                conn->idle = false;
+
+                if (!conn->cancel || conn->cancel.use_count() > 1) {
+                    conn->cancel = std::make_shared<cancellation>();
+                } else {
+                    conn->cancel->reset();
+                }
+                conn->cancel->on_first_listener(
+                    [this, weak_conn = std::weak_ptr(conn), cancel = std::weak_ptr(conn->cancel)] {
+                        if (auto conn = weak_conn.lock()) {
+                            net::post(conn->stream.get_executor(), [this, conn, cancel] {
+                                start_watch(conn, cancel);
+                            });
+                        }
+                    });
+
+                std::optional<detail::alloc_scope> allocs;
+                if constexpr (tracking_allocations) {
+                    allocs.emplace(m_request_allocs);
+                }
+
+                co_await handle_request(std::move(req), conn->remote, conn->cancel, lambda);
+                co_await stop_watch(*conn);
+                allocs.reset();
 
-                co_await handle_request(std::move(req), lambda);
                 if (close) {
                     // Send a TCP shutdown
                     stream.socket().shutdown(tcp::socket::shutdown_send);
@@ -103,8 +234,17 @@ struct server_impl {
                 }
             }
         } catch (std::exception& err) {
-            std::cerr << err.what() << '\n';
+            if (!m_stopping) {
+                std::cerr << err.what() << '\n';
+            }
+        }
+
+        if (conn->cancel) {
+            conn->cancel->reset();
         }
+
+        std::lock_guard lock{m_state_mutex};
+        m_connections.erase(conn);
     }
 
     net::awaitable<void> do_listen(net::io_context& ioc, tcp::endpoint endpoint) {
@@ -113,7 +253,9 @@ struct server_impl {
         std::cerr << "Listening...\n";
 
         // Open the acceptor
-        tcp::acceptor acceptor(ioc);
+        auto acceptor_ptr =
+            std::make_shared<tcp::acceptor>(co_await net::this_coro::executor);
+        auto& acceptor = *acceptor_ptr;
         acceptor.open(endpoint.protocol(), ec);
         if (ec)
             co_return fail(ec, "open");
@@ -133,17 +275,86 @@ struct server_impl {
         if (ec)
             co_return fail(ec, "listen");
 
-        for (;;) {
-            tcp::socket socket(ioc);
-            co_await acceptor.async_accept(socket, boost::asio::use_awaitable);
+        {
+            std::lock_guard lock{m_state_mutex};
+            if (m_stopping)
+                co_return;
+            m_acceptors.push_back(acceptor_ptr);
+        }
+
+        while (!m_stopping) {
+            // Every session gets its own strand so that stop can safely poke
+            // at its stream from another thread.
+            tcp::socket socket(net::make_strand(ioc));
+            co_await acceptor.async_accept(
+                socket, net::redirect_error(net::use_awaitable, ec));
+            if (ec) {
+                if (ec != net::error::operation_aborted)
+                    fail(ec, "accept");
+                continue;
+            }
             std::cerr << "Got connection\n";
 
-            boost::asio::co_spawn(ioc,
-                                  do_session(beast::tcp_stream(std::move(socket))),
-                                  boost::asio::detached);
-            if (ec)
-                fail(ec, "accept");
+            auto conn = std::make_shared<connection>(std::move(socket));
+            {
+                std::lock_guard lock{m_state_mutex};
+                m_connections.insert(conn);
+            }
+
+            boost::asio::co_spawn(
+                conn->stream.get_executor(), do_session(conn), boost::asio::detached);
         }
+
+        std::lock_guard lock{m_state_mutex};
+        std::erase(m_acceptors, acceptor_ptr);
+    }
+
+    net::awaitable<void> do_drain(std::chrono::steady_clock::time_point deadline) {
+        net::steady_timer timer(m_ioc);
+        for (;;) {
+            {
+                std::lock_guard lock{m_state_mutex};
+                if (m_connections.empty())
+                    break;
+            }
+            if (std::chrono::steady_clock::now() >= deadline) {
+                std::cerr << "Shutdown deadline passed, dropping connections\n";
+                break;
+            }
+            timer.expires_after(std::chrono::milliseconds(10));
+            co_await timer.async_wait(net::use_awaitable);
+        }
+
+        m_ioc.stop();
+    }
+
+    void stop(std::chrono::steady_clock::time_point deadline) {
+        if (m_stopping.exchange(true)) {
+            return;
+        }
+
+        std::cerr << "Stopping...\n";
+
+        std::lock_guard lock{m_state_mutex};
+        for (auto& acceptor : m_acceptors) {
+            net::post(acceptor->get_executor(), [acceptor] {
+                beast::error_code ec;
+                acceptor->close(ec);
+            });
+        }
+
+        // Sessions blocked on reading the next request will never produce a
+        // response, so they are cut right away. The others notice the flag
+        // once their current response goes out.
+        for (auto& conn : m_connections) {
+            net::post(conn->stream.get_executor(), [conn] {
+                if (conn->idle) {
+                    conn->stream.cancel();
+                }
+            });
+        }
+
+        boost::asio::co_spawn(m_ioc, do_drain(deadline), boost::asio::detached);
     }
 
     void listen(int p_port) {
@@ -151,8 +362,17 @@ struct server_impl {
         auto const port = static_cast<unsigned short>(p_port);
         auto const threads = std::max<int>(1, std::thread::hardware_concurrency());
 
-        boost::asio::co_spawn(
-            m_ioc, do_listen(m_ioc, tcp::endpoint{address, port}), boost::asio::detached);
+        // The acceptor lives on a strand, stop closes it from there.
+        boost::asio::co_spawn(net::make_strand(m_ioc),
+                              do_listen(m_ioc, tcp::endpoint{address, port}),
+                              boost::asio::detached);
+
+        net::signal_set signals(m_ioc, SIGINT, SIGTERM);
+        signals.async_wait([this](beast::error_code ec, int) {
+            if (!ec) {
+                stop(std::chrono::steady_clock::now() + std::chrono::seconds(10));
+            }
+        });
 
         // Run the I/O service on the requested number of threads
         std::vector<std::thread> v;
@@ -174,5 +394,13 @@ void server::listen(int p_port) {
     m_impl->listen(p_port);
 }
 
+void server::stop(std::chrono::steady_clock::time_point deadline) {
+    m_impl->stop(deadline);
+}
+
+void server::stop(std::chrono::steady_clock::duration grace) {
+    m_impl->stop(std::chrono::steady_clock::now() + grace);
+}
+
 server::~server() = default;
 } // namespace v60